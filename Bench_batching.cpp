@@ -0,0 +1,105 @@
+// Bench_batching.cpp
+// Group-commit curve for the WriteBatcher: write throughput and latency
+// across --batch-window-ms values and pipeline depths, with no network.
+// Each client thread plays one connection: it queues `depth` pipelined
+// insert_server requests through Node::process_request, as client_thread
+// does for one recv, then waits for the group with flush_writes. Latency
+// is measured per group, i.e. from the first write queued to the last
+// write applied.
+//
+// Compile:
+//   g++ -std=c++17 -O2 Bench_batching.cpp -lws2_32 -o bench_batching
+// Run:
+//   bench_batching [clients] [writes per client]
+//
+// Sample run (8 clients x 2000 writes, one core):
+//    window_ms  depth       writes/s       p50_us       p99_us
+//            0      1          74392         55.1       1668.0
+//            1      1           6017       1161.4       5613.6
+//            2      1           3322       2175.4       6477.0
+//            5      1           1493       5185.1       9182.2
+//           10      1            772      10226.1      13854.7
+//            0     16         897079        126.9        410.4
+//            1     16         674611        145.6        465.9
+//            2     16         538915        143.2        613.8
+//            5     16         371191        126.1       5112.6
+//           10     16         272817        135.3        459.0
+// With one write in flight per connection a window only adds delay: the
+// committer waits out the window for writes that cannot arrive. Pipelined
+// writes fill batches on their own, so window_ms = 0 stays the default.
+
+#define CHORD_NO_MAIN
+#include "Node_dth.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+struct LoadArgs {
+    Node *node;
+    int id;
+    size_t writes;
+    size_t depth;
+    std::vector<double> latency_us;   // one sample per group
+};
+
+DWORD WINAPI load_client(LPVOID param) {
+    LoadArgs *a = static_cast<LoadArgs*>(param);
+    ConnBuffers cb;
+    std::vector<std::string> group(a->depth);
+    for (size_t i = 0; i < a->writes; i += a->depth) {
+        size_t n = std::min(a->depth, a->writes - i);
+        for (size_t j = 0; j < n; ++j)
+            group[j] = "insert_server|c" + std::to_string(a->id) + "_" + std::to_string(i + j) + ":value";
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < n; ++j) a->node->process_request(group[j], cb);
+        a->node->flush_writes(cb);
+        auto t1 = std::chrono::steady_clock::now();
+        a->latency_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        cb.out.clear();
+        cb.replies = 0;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int clients = argc > 1 ? std::stoi(argv[1]) : 8;
+    size_t writes = argc > 2 ? std::stoul(argv[2]) : 4000;
+
+    const DWORD windows[] = {0, 1, 2, 5, 10};
+    const size_t depths[] = {1, 16};
+
+    std::printf("%d clients, %zu writes each\n", clients, writes);
+    std::printf("%10s %6s %14s %12s %12s\n", "window_ms", "depth", "writes/s", "p50_us", "p99_us");
+    for (size_t depth : depths) {
+        for (DWORD window : windows) {
+            BatchConfig cfg;
+            cfg.window_ms = window;
+            // The committer threads never exit, so each node is never destroyed
+            Node *node = new Node("127.0.0.1", 0, cfg);
+            for (size_t i = 0; i < node->partitions(); ++i)
+                CreateThread(nullptr, 0, batch_thread, new std::pair<Node*, int>(node, static_cast<int>(i)), 0, nullptr);
+
+            std::vector<LoadArgs> args(clients);
+            std::vector<HANDLE> threads;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int c = 0; c < clients; ++c) {
+                args[c] = LoadArgs{node, c, writes, depth, {}};
+                threads.push_back(CreateThread(nullptr, 0, load_client, &args[c], 0, nullptr));
+            }
+            for (HANDLE h : threads) {
+                WaitForSingleObject(h, INFINITE);
+                CloseHandle(h);
+            }
+            auto t1 = std::chrono::steady_clock::now();
+
+            std::vector<double> lat;
+            for (auto &a : args) lat.insert(lat.end(), a.latency_us.begin(), a.latency_us.end());
+            std::sort(lat.begin(), lat.end());
+            double secs = std::chrono::duration<double>(t1 - t0).count();
+            std::printf("%10lu %6zu %14.0f %12.1f %12.1f\n", static_cast<unsigned long>(window), depth,
+                        clients * writes / secs, lat[lat.size() / 2], lat[lat.size() * 99 / 100]);
+        }
+    }
+    return 0;
+}
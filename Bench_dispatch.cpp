@@ -0,0 +1,86 @@
+// Bench_dispatch.cpp
+// Microbenchmark for Node::process_request: requests/s on one core and
+// heap allocations per request, driven in a loop with no network.
+// Only server-side opcodes are measured; the client opcodes forward over
+// TCP. Writes go through the partition's WriteBatcher as on a real
+// connection, one at a time (pipeline depth 1), so their rate includes
+// the committer handoff; Bench_batching.cpp measures deeper pipelines.
+//
+// Compile:
+//   g++ -std=c++17 -O2 Bench_dispatch.cpp -lws2_32 -o bench_dispatch
+
+#define CHORD_NO_MAIN
+#include "Node_dth.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <new>
+
+// Counts every global heap allocation in the process. All plain, array
+// and sized forms are replaced together so every new pairs with a
+// matching delete.
+static std::atomic<size_t> g_allocs{0};
+
+static void *counted_alloc(size_t n) {
+    ++g_allocs;
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t n) { return counted_alloc(n); }
+void *operator new[](size_t n) { return counted_alloc(n); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char* argv[]) {
+    size_t iters = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+    // The committer threads never exit, so the node is never destroyed.
+    // A non-loopback address keeps NodeInfo strings out of SSO range.
+    Node &node = *new Node("192.168.100.200", 65535);
+    for (size_t i = 0; i < node.partitions(); ++i)
+        CreateThread(nullptr, 0, batch_thread, new std::pair<Node*, int>(&node, static_cast<int>(i)), 0, nullptr);
+
+    const char *requests[] = {
+        "insert_server|user:42:session-token-0123456789abcdef",
+        "search_server|user:42",
+        "getv_server|user:42",
+        "search_server|missing-key",
+        "insert_ttl_server|60000|ttl:7:short-lived",
+        "cas_server|1|user:42:never-matches",
+        "delete_server|nobody",
+        "get_successor|",
+        "join_request|17",
+        "no_such_op|x",
+    };
+
+    ConnBuffers cb;
+    // One request as client_thread serves it, reply included
+    auto dispatch = [&](std::string_view msg) {
+        if (node.process_request(msg, cb)) cb.reply(cb.resp);
+        node.flush_writes(cb);
+        cb.out.clear();
+        cb.replies = 0;
+    };
+    std::printf("%-28s %14s %14s\n", "request", "req/s", "allocs/req");
+    for (const char *req : requests) {
+        std::string_view msg(req);
+        // Warm up: create the key and grow the connection's buffers
+        for (int i = 0; i < 1000; ++i) dispatch(msg);
+
+        size_t before = g_allocs.load();
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iters; ++i) dispatch(msg);
+        auto t1 = std::chrono::steady_clock::now();
+        size_t allocs = g_allocs.load() - before;
+
+        double secs = std::chrono::duration<double>(t1 - t0).count();
+        std::string_view name = msg.substr(0, msg.find('|'));
+        std::printf("%-28.*s %14.0f %14.3f\n", static_cast<int>(name.size()), name.data(),
+                    iters / secs, static_cast<double>(allocs) / iters);
+    }
+    return 0;
+}
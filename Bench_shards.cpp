@@ -0,0 +1,121 @@
+// Bench_shards.cpp
+// Core-scaling benchmark for --shards and --vnodes: for N = 1, 2, 4, ...
+// up to 32 cores, N client threads, each pinned to its own core, drive
+// Node::process_request in a loop with no network. Requests are a
+// read-mostly mix.
+//   shards: one node with N partitions. Keys are spread across every
+//     partition, so the numbers include cross-partition reads and writes
+//     handed to other cores' committers.
+//   vnodes: N virtual nodes, one per core, each client driving its own
+//     node over its own slice of the keys. Nothing is shared, so this is
+//     the ceiling for --vnodes: a request that lands on the wrong virtual
+//     node is forwarded over loopback, which is not measured here.
+// Reports throughput and speedup over one core for each mode.
+//
+// Compile:
+//   g++ -std=c++17 -O2 Bench_shards.cpp -lws2_32 -o bench_shards
+// Run:
+//   bench_shards [requests per thread] [write percent] [max cores]
+// max cores defaults to the CPU count (at most 32); asking for more
+// than the machine has stacks threads on cores and measures nothing.
+
+#define CHORD_NO_MAIN
+#include "Node_dth.cpp"
+
+#include <chrono>
+#include <cstdio>
+
+static const int KEYS = 4096;
+
+struct ShardArgs {
+    Node *node;
+    int core;
+    int first_key, key_step;   // this client's keys
+    size_t requests;
+    int write_pct;
+};
+
+DWORD WINAPI shard_client(LPVOID param) {
+    ShardArgs *a = static_cast<ShardArgs*>(param);
+    pin_to_core(a->core);
+    ConnBuffers cb;
+    std::vector<std::string> reads, writes;
+    for (int k = a->first_key; k < KEYS; k += a->key_step) {
+        reads.push_back("search_server|key:" + std::to_string(k));
+        writes.push_back("insert_server|key:" + std::to_string(k) + ":value-" + std::to_string(a->core));
+    }
+    uint32_t rng = 2463534242u + a->core;
+    for (size_t i = 0; i < a->requests; ++i) {
+        rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+        int k = rng % reads.size();
+        const std::string &req = static_cast<int>(rng >> 16) % 100 < a->write_pct ? writes[k] : reads[k];
+        if (a->node->process_request(req, cb)) cb.reply(cb.resp);
+        a->node->flush_writes(cb);
+        cb.out.clear();
+        cb.replies = 0;
+    }
+    return 0;
+}
+
+// Starts a node's committers and loads its share of the keys
+static Node *make_node(size_t shards, int first_key, int key_step) {
+    // The committer threads never exit, so each node is never destroyed
+    Node *node = new Node("127.0.0.1", 0, BatchConfig(), shards);
+    for (size_t i = 0; i < shards; ++i)
+        CreateThread(nullptr, 0, batch_thread, new std::pair<Node*, int>(node, static_cast<int>(i)), 0, nullptr);
+    ConnBuffers cb;
+    for (int k = first_key; k < KEYS; k += key_step) {
+        std::string req = "insert_server|key:" + std::to_string(k) + ":initial";
+        node->process_request(req, cb);
+        node->flush_writes(cb);
+        cb.out.clear();
+    }
+    return node;
+}
+
+// Requests per second for n client threads on n cores
+static double run(int n, bool vnodes, size_t requests, int write_pct) {
+    std::vector<ShardArgs> args(n);
+    if (vnodes) {
+        for (int c = 0; c < n; ++c) {
+            Node *node = make_node(1, c, n);
+            node->run_as_vnode(c, {});
+            args[c] = ShardArgs{node, c, c, n, requests, write_pct};
+        }
+    } else {
+        Node *node = make_node(n, 0, 1);
+        for (int c = 0; c < n; ++c) args[c] = ShardArgs{node, c, 0, 1, requests, write_pct};
+    }
+
+    std::vector<HANDLE> threads;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int c = 0; c < n; ++c)
+        threads.push_back(CreateThread(nullptr, 0, shard_client, &args[c], 0, nullptr));
+    for (HANDLE h : threads) {
+        WaitForSingleObject(h, INFINITE);
+        CloseHandle(h);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return n * requests / std::chrono::duration<double>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t requests = argc > 1 ? std::stoul(argv[1]) : 200000;
+    int write_pct = argc > 2 ? std::stoi(argv[2]) : 10;
+    int max_cores = argc > 3 ? std::stoi(argv[3]) : std::min(32, cpu_count());
+
+    std::printf("%zu requests per thread, %d%% writes, %d CPUs\n", requests, write_pct, cpu_count());
+    std::printf("%6s %14s %9s %14s %9s\n", "cores", "shards req/s", "speedup", "vnodes req/s", "speedup");
+    double shards_base = 0, vnodes_base = 0;
+    for (int n = 1; n <= max_cores; n *= 2) {
+        double shards = run(n, false, requests, write_pct);
+        double vnodes = run(n, true, requests, write_pct);
+        if (n == 1) {
+            shards_base = shards;
+            vnodes_base = vnodes;
+        }
+        std::printf("%6d %14.0f %9.2f %14.0f %9.2f\n", n, shards, shards / shards_base,
+                    vnodes, vnodes / vnodes_base);
+    }
+    return 0;
+}
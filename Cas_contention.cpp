@@ -0,0 +1,141 @@
+// cas_contention.cpp
+// Contention test for compare-and-set: every thread increments the same
+// counter key with getv + cas, retrying on CONFLICT, then the final value
+// is checked against the number of increments. Reports throughput and how
+// many cas attempts lost a race.
+//
+// Usage: cas_contention <port> [threads] [increments per thread] [key]
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#pragma comment(lib, "Ws2_32.lib")  // Link Ws2_32.lib
+
+using namespace std;
+
+static string ip = "127.0.0.1";
+static int port;
+static string key = "cas_counter";
+static int increments = 500;
+
+static atomic<long> committed{0};
+static atomic<long> conflicts{0};
+static atomic<long> errors{0};
+
+// One request/reply on a persistent connection; requests end in '\n'
+bool call(SOCKET sock, const string &message, string &reply) {
+    string line = message + "\n";
+    if (send(sock, line.c_str(), (int)line.length(), 0) <= 0) return false;
+    char buffer[1024];
+    int recv_size = recv(sock, buffer, sizeof(buffer), 0);
+    if (recv_size <= 0) return false;
+    reply.assign(buffer, recv_size);
+    return true;
+}
+
+SOCKET open_connection() {
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return sock;
+    struct sockaddr_in server;
+    server.sin_addr.s_addr = inet_addr(ip.c_str());
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if (connect(sock, (struct sockaddr*)&server, sizeof(server)) < 0) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+DWORD WINAPI worker(LPVOID) {
+    SOCKET sock = open_connection();
+    if (sock == INVALID_SOCKET) {
+        errors++;
+        return 0;
+    }
+    string reply;
+    for (int i = 0; i < increments; ) {
+        // reply is "<version>|<value>"
+        if (!call(sock, "getv|" + key, reply)) { errors++; break; }
+        size_t bar = reply.find('|');
+        if (bar == string::npos) { errors++; break; }
+        string version = reply.substr(0, bar);
+        long value = stol(reply.substr(bar + 1));
+
+        // reply is "OK|<new version>" or "CONFLICT|<current version>"
+        if (!call(sock, "cas|" + version + "|" + key + ":" + to_string(value + 1), reply)) { errors++; break; }
+        if (reply.compare(0, 3, "OK|") == 0) {
+            committed++;
+            i++;
+        } else if (reply.compare(0, 9, "CONFLICT|") == 0) {
+            conflicts++;
+        } else {
+            errors++;
+            break;
+        }
+    }
+    closesocket(sock);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <port> [threads] [increments per thread] [key]\n";
+        return 1;
+    }
+    port = stoi(argv[1]);
+    int threads = argc > 2 ? stoi(argv[2]) : 8;
+    if (argc > 3) increments = stoi(argv[3]);
+    if (argc > 4) key = argv[4];
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        cout << "WSAStartup failed. Error Code: " << WSAGetLastError() << endl;
+        return 1;
+    }
+
+    SOCKET sock = open_connection();
+    if (sock == INVALID_SOCKET) {
+        cout << "Connection failed. Error Code: " << WSAGetLastError() << endl;
+        return 1;
+    }
+    string reply;
+    if (!call(sock, "insert|" + key + ":0", reply) || reply.compare(0, 3, "OK|") != 0) {
+        cout << "Could not reset " << key << ": " << reply << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<HANDLE> handles;
+    for (int t = 0; t < threads; ++t)
+        handles.push_back(CreateThread(nullptr, 0, worker, nullptr, 0, nullptr));
+    for (HANDLE h : handles) {
+        WaitForSingleObject(h, INFINITE);
+        CloseHandle(h);
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    long expected = (long)threads * increments;
+    long final_value = -1;
+    if (call(sock, "getv|" + key, reply) && reply.find('|') != string::npos)
+        final_value = stol(reply.substr(reply.find('|') + 1));
+    closesocket(sock);
+    WSACleanup();
+
+    cout << threads << " threads x " << increments << " increments on " << key << "\n";
+    cout << "committed: " << committed << "  conflicts: " << conflicts << "  errors: " << errors << "\n";
+    cout << "cas/s: " << committed / secs << "  conflict rate: "
+         << (double)conflicts / (committed + conflicts) << "\n";
+    cout << "final value: " << final_value << " (expected " << expected << ")\n";
+    if (final_value != expected || errors != 0) {
+        cout << "FAILED" << endl;
+        return 1;
+    }
+    cout << "PASSED" << endl;
+    return 0;
+}
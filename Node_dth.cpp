@@ -1,14 +1,25 @@
 /*
  * C++17 Chord DHT Node (Boost-free, Winsock2, CRITICAL_SECTION, Win32 threads)
  * -----------------------------------------------------------------------------
- * - DataStore: thread-safe key/value store via Windows CRITICAL_SECTION
+ * - HybridClock: hybrid logical clock, one per DataStore partition, that
+ *   versions every value
+ * - TimerWheel: hierarchical timing wheel that drives key expiry (TTL)
+ * - DataStore: thread-safe versioned key/value store via Windows CRITICAL_SECTION,
+ *   split into independently locked partitions, with optional TTLs and a
+ *   CLOCK-evicted byte budget
+ * - KeyStream: binary bulk-transfer format for key migration
+ * - WriteBatcher: group commit of server-side writes into the DataStore
  * - NodeInfo: IP, port, ID
  * - FingerTable: routing table entries
  * - RequestHandler: synchronous TCP client via Winsock2
  * - Node: Chord logic + RPC server
  *
  * Networking: Winsock2 blocking sockets
- * Threading: Win32 CreateThread
+ * Threading: Win32 CreateThread; --shards=N (1..CPU count) splits the store
+ *   into N partitions and pins their N committers and N accept loops to
+ *   cores 0..N-1. --vnodes=N instead runs N virtual nodes, one per core,
+ *   each a whole Node with its own port, store and threads; they form a
+ *   ring of their own and forward requests to each other over loopback
  * Synchronization: CRITICAL_SECTION
  * ID hashing: std::hash<string> % (2^m), m=7
  * Compile:
@@ -20,10 +31,17 @@
  #include <windows.h>
  #include <iostream>
  #include <string>
+ #include <string_view>
  #include <vector>
  #include <unordered_map>
- #include <sstream>
  #include <functional>
+ #include <charconv>
+ #include <algorithm>
+ #include <array>
+ #include <cstdint>
+ #include <cstring>
+ #include <memory>
+ #include <deque>
  #include <cstdlib>   // for rand, srand
  #include <ctime>     // for time()
  
@@ -42,6 +60,7 @@
      ~Mutex() { DeleteCriticalSection(&cs); }
      void lock()   { EnterCriticalSection(&cs); }
      void unlock() { LeaveCriticalSection(&cs); }
+     CRITICAL_SECTION *native() { return &cs; }
  };
  
  // LockGuard for our Mutex
@@ -52,44 +71,858 @@
      ~LockGuard()           { m.unlock(); }
  };
  
- // Thread-safe key/value store
+ // Condition variable paired with our Mutex
+ class CondVar {
+     CONDITION_VARIABLE cv;
+ public:
+     CondVar() { InitializeConditionVariable(&cv); }
+     // Caller holds m; returns false on timeout
+     bool wait(Mutex &m, DWORD ms = INFINITE) {
+         return SleepConditionVariableCS(&cv, m.native(), ms) != 0;
+     }
+     void notify_one() { WakeConditionVariable(&cv); }
+     void notify_all() { WakeAllConditionVariable(&cv); }
+ };
+ 
+ // One queued server-side write; key and value are owned by the
+ // submitting connection, which blocks until the write is applied
+ struct WriteOp {
+     enum Kind { Put, Erase, Cas };
+     Kind kind;
+     const std::string *key;
+     std::string_view value;
+     uint64_t expect = 0;    // Cas: required current version, 0 = key absent
+     uint64_t ttl_ms = 0;    // Put: expire this long after the write, 0 = never
+     uint64_t version = 0;   // out: version written, or current version on a failed Cas
+     bool ok = false;        // out: false when a Cas did not match
+     bool done = false;
+     uint64_t queued_ms = 0; // when a WriteBatcher with a window queued it
+ };
+ 
+ // Hybrid logical clock. A version packs
+ //   44 bits wall-clock ms | 13 bits logical counter | 7 bits node id
+ // so versions issued by one clock strictly increase, versions from two
+ // nodes never tie, and across nodes they follow wall time as long as
+ // clocks roughly agree. Each DataStore partition has its own clock, so
+ // two partitions of a node can issue equal versions; that is harmless
+ // because a key always lives in the same partition, and versions are
+ // only ever compared between copies of one key. Callers serialise access.
+ class HybridClock {
+     uint64_t last_ = 0;   // ms << 13 | logical
+ public:
+     static constexpr int NODE_BITS = m;
+ 
+     uint64_t tick(int node_id) {
+         last_ = std::max(last_ + 1, wall_ms() << 13);
+         return (last_ << NODE_BITS) | static_cast<uint64_t>(node_id & (RING_SIZE - 1));
+     }
+     // Moves the clock past a version issued elsewhere
+     void observe(uint64_t version) {
+         last_ = std::max(last_, version >> NODE_BITS);
+     }
+     static uint64_t wall_ms() {
+         FILETIME ft;
+         GetSystemTimeAsFileTime(&ft);
+         uint64_t t = (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+         return (t - 116444736000000000ULL) / 10000;   // 100ns since 1601 -> ms since 1970
+     }
+ };
+ 
+ // Binary bulk-transfer stream used by send_keys to migrate keys
+ //
+ //   stream := "CKS4" block*
+ //   block  := u32 raw_len | u32 stored_len | u8 flags | u32 crc32(raw) | stored
+ //   raw    := entry*
+ //   entry  := varint shared | varint suffix_len | suffix
+ //             | varint version | varint expires_ms | varint value_len+1 | value
+ //
+ // Integers are little-endian. Keys are sorted and delta-encoded against
+ // the previous key in the same block (shared prefix + suffix), and every
+ // block is self-contained, so a receiver can verify and apply whole
+ // blocks and resume from the stream offset of the first one it has not
+ // applied. expires_ms is absolute wall-clock time, 0 for keys without a
+ // TTL. Bit 0 of flags marks a block packed with the LZ codec below;
+ // blocks that do not shrink are stored raw.
+ // A value_len+1 of 0 marks a tombstone: the key was deleted at the sender
+ // after it shipped this version, and the entry has no value.
+ class KeyStream {
+ public:
+     static constexpr char MAGIC[4] = {'C', 'K', 'S', '4'};
+     static constexpr size_t HEADER_SIZE = 13;
+     static constexpr size_t BLOCK_SIZE = 32 * 1024;
+     static constexpr uint8_t FLAG_LZ = 1;
+ 
+     enum class Status { Ok, Incomplete, Corrupt };
+ 
+     // Builds a stream into out, which is appended to
+     class Writer {
+         std::string &out_;
+         std::string raw_, packed_, prev_;
+         bool compress_;
+     public:
+         explicit Writer(std::string &out, bool compress = true)
+             : out_(out), compress_(compress) {
+             out_.append(MAGIC, sizeof(MAGIC));
+         }
+         // Keys must be added in ascending order
+         void add(std::string_view k, uint64_t version, uint64_t expires_ms, std::string_view v) {
+             add_key(k, version, expires_ms);
+             put_varint(raw_, v.size() + 1);
+             raw_.append(v.data(), v.size());
+             if (raw_.size() >= BLOCK_SIZE) flush();
+         }
+         void add_tombstone(std::string_view k, uint64_t version) {
+             add_key(k, version, 0);
+             put_varint(raw_, 0);
+             if (raw_.size() >= BLOCK_SIZE) flush();
+         }
+         void finish() { flush(); }
+     private:
+         void add_key(std::string_view k, uint64_t version, uint64_t expires_ms) {
+             size_t shared = 0;
+             size_t lim = std::min(k.size(), prev_.size());
+             while (shared < lim && k[shared] == prev_[shared]) ++shared;
+             put_varint(raw_, shared);
+             put_varint(raw_, k.size() - shared);
+             raw_.append(k.data() + shared, k.size() - shared);
+             put_varint(raw_, version);
+             put_varint(raw_, expires_ms);
+             prev_.assign(k.data(), k.size());
+         }
+         void flush() {
+             if (raw_.empty()) return;
+             uint8_t flags = 0;
+             const std::string *stored = &raw_;
+             if (compress_) {
+                 packed_.clear();
+                 lz_compress(raw_, packed_);
+                 if (packed_.size() < raw_.size()) {
+                     flags |= FLAG_LZ;
+                     stored = &packed_;
+                 }
+             }
+             put_u32(out_, static_cast<uint32_t>(raw_.size()));
+             put_u32(out_, static_cast<uint32_t>(stored->size()));
+             out_.push_back(static_cast<char>(flags));
+             put_u32(out_, crc32(raw_));
+             out_.append(*stored);
+             raw_.clear();
+             prev_.clear();
+         }
+     };
+ 
+     // Checks the stream magic at the front of in
+     static bool read_magic(std::string_view in) {
+         return in.size() >= sizeof(MAGIC) && std::memcmp(in.data(), MAGIC, sizeof(MAGIC)) == 0;
+     }
+ 
+     // Decodes the block at the front of in and calls
+     // apply(key, version, expires_ms, value, tombstone) for each entry
+     // once the checksum has verified. used is set to the block's
+     // length on Ok; raw and key are caller-owned scratch buffers.
+     template <class F>
+     static Status read_block(std::string_view in, size_t &used,
+                              std::string &raw, std::string &key, F &&apply) {
+         if (in.size() < HEADER_SIZE) return Status::Incomplete;
+         const unsigned char *h = reinterpret_cast<const unsigned char*>(in.data());
+         uint32_t raw_len = get_u32(h), stored_len = get_u32(h + 4), crc = get_u32(h + 9);
+         uint8_t flags = h[8];
+         if (flags & ~FLAG_LZ) return Status::Corrupt;
+         if (raw_len > 16 * BLOCK_SIZE || stored_len > 16 * BLOCK_SIZE) return Status::Corrupt;
+         if (in.size() < HEADER_SIZE + stored_len) return Status::Incomplete;
+         std::string_view stored = in.substr(HEADER_SIZE, stored_len);
+         if (flags & FLAG_LZ) {
+             if (!lz_decompress(stored, raw_len, raw)) return Status::Corrupt;
+         } else {
+             if (stored_len != raw_len) return Status::Corrupt;
+             raw.assign(stored.data(), stored.size());
+         }
+         if (crc32(raw) != crc) return Status::Corrupt;
+ 
+         std::string_view r(raw);
+         size_t pos = 0;
+         key.clear();
+         while (pos < r.size()) {
+             uint64_t shared, suffix, version, expires, vlen;
+             if (!get_varint(r, pos, shared) || shared > key.size()) return Status::Corrupt;
+             if (!get_varint(r, pos, suffix) || suffix > r.size() - pos) return Status::Corrupt;
+             key.resize(shared);
+             key.append(r.data() + pos, suffix);
+             pos += suffix;
+             if (!get_varint(r, pos, version) || !get_varint(r, pos, expires)) return Status::Corrupt;
+             if (!get_varint(r, pos, vlen) || vlen > r.size() - pos + 1) return Status::Corrupt;
+             if (vlen == 0) {
+                 apply(std::string_view(key), version, expires, std::string_view(), true);
+                 continue;
+             }
+             apply(std::string_view(key), version, expires, r.substr(pos, vlen - 1), false);
+             pos += vlen - 1;
+         }
+         used = HEADER_SIZE + stored_len;
+         return Status::Ok;
+     }
+ 
+     static uint32_t crc32(std::string_view s) {
+         static const std::array<uint32_t, 256> table = [] {
+             std::array<uint32_t, 256> t{};
+             for (uint32_t i = 0; i < 256; ++i) {
+                 uint32_t c = i;
+                 for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                 t[i] = c;
+             }
+             return t;
+         }();
+         uint32_t c = 0xFFFFFFFFu;
+         for (unsigned char b : s) c = table[(c ^ b) & 0xFF] ^ (c >> 8);
+         return c ^ 0xFFFFFFFFu;
+     }
+ 
+     // Byte-oriented LZ77: a block is a run of
+     //   varint literal_len | literals | varint match_len [| varint offset]
+     // terminated by match_len = 0. Matches are at least 4 bytes and found
+     // through a 4-byte hash of the last position seen.
+     static void lz_compress(std::string_view in, std::string &out) {
+         static constexpr int HASH_BITS = 12;
+         static constexpr size_t MAX_OFFSET = 64 * 1024;
+         std::array<uint32_t, 1u << HASH_BITS> last;
+         last.fill(UINT32_MAX);
+         const unsigned char *p = reinterpret_cast<const unsigned char*>(in.data());
+         size_t n = in.size(), i = 0, anchor = 0;
+         while (i + 4 <= n) {
+             uint32_t word;
+             std::memcpy(&word, p + i, 4);
+             uint32_t hsh = (word * 2654435761u) >> (32 - HASH_BITS);
+             uint32_t cand = last[hsh];
+             last[hsh] = static_cast<uint32_t>(i);
+             if (cand != UINT32_MAX && i - cand <= MAX_OFFSET && std::memcmp(p + cand, p + i, 4) == 0) {
+                 size_t len = 4;
+                 while (i + len < n && p[cand + len] == p[i + len]) ++len;
+                 put_varint(out, i - anchor);
+                 out.append(in.data() + anchor, i - anchor);
+                 put_varint(out, len);
+                 put_varint(out, i - cand);
+                 i += len;
+                 anchor = i;
+             } else {
+                 ++i;
+             }
+         }
+         put_varint(out, n - anchor);
+         out.append(in.data() + anchor, n - anchor);
+         put_varint(out, 0);
+     }
+ 
+     static bool lz_decompress(std::string_view in, size_t raw_len, std::string &out) {
+         out.clear();
+         size_t pos = 0;
+         while (true) {
+             uint64_t lit, len, off;
+             if (!get_varint(in, pos, lit) || lit > in.size() - pos || lit > raw_len - out.size()) return false;
+             out.append(in.data() + pos, lit);
+             pos += lit;
+             if (!get_varint(in, pos, len)) return false;
+             if (len == 0) break;
+             if (!get_varint(in, pos, off) || off == 0 || off > out.size() || len > raw_len - out.size()) return false;
+             // Byte-by-byte so overlapping matches repeat correctly
+             size_t from = out.size() - off;
+             for (uint64_t k = 0; k < len; ++k) out.push_back(out[from + k]);
+         }
+         return pos == in.size() && out.size() == raw_len;
+     }
+ 
+     static void put_varint(std::string &out, uint64_t v) {
+         while (v >= 0x80) {
+             out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+             v >>= 7;
+         }
+         out.push_back(static_cast<char>(v));
+     }
+     static bool get_varint(std::string_view in, size_t &pos, uint64_t &v) {
+         v = 0;
+         for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+             unsigned char b = static_cast<unsigned char>(in[pos++]);
+             v |= static_cast<uint64_t>(b & 0x7F) << shift;
+             if (!(b & 0x80)) return true;
+         }
+         return false;
+     }
+     static void put_u32(std::string &out, uint32_t v) {
+         for (int k = 0; k < 4; ++k) out.push_back(static_cast<char>((v >> (8 * k)) & 0xFF));
+     }
+     static uint32_t get_u32(const unsigned char *p) {
+         return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+     }
+ };
+ 
+ // Hierarchical timing wheel: LEVELS wheels of SLOTS slots each. Level 0
+ // slots are one tick wide, and a level-n slot spans a full turn of level
+ // n-1. A timer goes into the lowest level whose current turn contains
+ // its tick. When a lower level wraps, the next slot of the level above
+ // is spilled down a level. Scheduling and cancelling are O(1), and a
+ // timer moves at most LEVELS-1 times before it fires. Timers past the
+ // top level's range are parked in its last slot; whoever handles them
+ // re-checks the real expiry and schedules again. Callers serialise access.
+ //
+ // Timers are intrusive: each is embedded in the entry it times and
+ // linked into one slot list, so rescheduling moves it instead of adding
+ // another, and the owner cancels it before the entry goes away.
+ class TimerWheel {
+ public:
+     struct Timer {
+         Timer *prev = nullptr, *next = nullptr;   // next == nullptr: not linked
+         const std::string *key = nullptr;         // owner's key, for the sweeper
+         uint64_t expires_ms = 0;
+         Timer() = default;
+         Timer(const Timer &) = delete;
+         Timer &operator=(const Timer &) = delete;
+         bool scheduled() const { return next != nullptr; }
+     };
+     static constexpr uint64_t TICK_MS = 100;
+     static constexpr int LEVELS = 4;
+     static constexpr int SLOT_BITS = 6;
+     static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+ 
+     explicit TimerWheel(uint64_t now_ms) : now_(now_ms / TICK_MS) {}
+     TimerWheel(const TimerWheel &) = delete;
+     TimerWheel &operator=(const TimerWheel &) = delete;
+ 
+     // (Re)schedules tm, moving it if it is already linked
+     void schedule(Timer &tm, uint64_t expires_ms) {
+         if (tm.scheduled()) List::unlink(tm);
+         tm.expires_ms = expires_ms;
+         uint64_t t = (expires_ms + TICK_MS - 1) / TICK_MS;   // never fire early
+         place(tm, std::max(t, now_ + 1));
+     }
+     void cancel(Timer &tm) {
+         if (tm.scheduled()) List::unlink(tm);
+     }
+ 
+     // Advances to now_ms, moving every timer whose tick has passed to the
+     // due list
+     void advance(uint64_t now_ms) {
+         uint64_t target = now_ms / TICK_MS;
+         while (now_ < target) {
+             ++now_;
+             // Spill higher levels first, so the timers land where the
+             // lower levels are about to look
+             int top = 0;
+             while (top + 1 < LEVELS && (now_ & ((uint64_t(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) ++top;
+             for (int lvl = top; lvl >= 1; --lvl) {
+                 List &slot = wheel_[lvl][(now_ >> (SLOT_BITS * lvl)) & (SLOTS - 1)];
+                 while (Timer *tm = slot.pop()) {
+                     uint64_t t = (tm->expires_ms + TICK_MS - 1) / TICK_MS;
+                     place(*tm, std::max(t, now_));
+                 }
+             }
+             due_.splice(wheel_[0][now_ & (SLOTS - 1)]);
+         }
+     }
+     // Unlinks and returns the next due timer, nullptr when there is none
+     Timer *pop_due() { return due_.pop(); }
+ 
+ private:
+     // Circular doubly linked list through a sentinel
+     struct List {
+         Timer head;
+         List() { head.prev = head.next = &head; }
+         List(const List &) = delete;
+         List &operator=(const List &) = delete;
+         void push(Timer &tm) {
+             tm.prev = head.prev;
+             tm.next = &head;
+             head.prev->next = &tm;
+             head.prev = &tm;
+         }
+         Timer *pop() {
+             if (head.next == &head) return nullptr;
+             Timer *tm = head.next;
+             unlink(*tm);
+             return tm;
+         }
+         // Moves every timer of other to the back of this list
+         void splice(List &other) {
+             if (other.head.next == &other.head) return;
+             other.head.next->prev = head.prev;
+             head.prev->next = other.head.next;
+             other.head.prev->next = &head;
+             head.prev = other.head.prev;
+             other.head.prev = other.head.next = &other.head;
+         }
+         static void unlink(Timer &tm) {
+             tm.prev->next = tm.next;
+             tm.next->prev = tm.prev;
+             tm.prev = tm.next = nullptr;
+         }
+     };
+     std::array<std::array<List, SLOTS>, LEVELS> wheel_;
+     List due_;
+     uint64_t now_;   // last tick processed
+ 
+     void place(Timer &tm, uint64_t t) {
+         for (int lvl = 0; lvl < LEVELS; ++lvl) {
+             int shift = SLOT_BITS * (lvl + 1);
+             if ((t >> shift) == (now_ >> shift)) {
+                 wheel_[lvl][(t >> (SLOT_BITS * lvl)) & (SLOTS - 1)].push(tm);
+                 return;
+             }
+         }
+         // Out of range: park at the last tick of the top level's turn
+         place(tm, now_ | ((uint64_t(1) << (SLOT_BITS * LEVELS)) - 1));
+     }
+ };
+ 
+ // Thread-safe key/value store; every value carries the HybridClock
+ // version of the write that produced it. The store is split into
+ // partitions, each with its own map, lock, clock and timing wheel, and
+ // each key lives in exactly one. This is lock striping, not a
+ // share-nothing design: any thread may read any partition under its
+ // lock, and writes are handed to the partition's committer (pinned to
+ // a core in sharded mode), while routing and transfer state stay
+ // node-wide. For share-nothing, --vnodes gives each core a DataStore of
+ // its own. Bench_shards.cpp measures how both scale with cores.
+ //
+ // Keys may carry a TTL. Expired keys are dropped lazily by reads and
+ // reclaimed by expire(), which the node's sweeper calls every tick. With
+ // a byte budget, writes that push a partition over its share evict
+ // entries in CLOCK order.
  class DataStore {
  protected:
-     std::unordered_map<std::string, std::string> data_;
-     Mutex mu_;
+     struct Versioned {
+         std::string value;
+         uint64_t version = 0;
+         uint64_t expires_ms = 0;   // wall-clock ms, 0 = no TTL
+         bool referenced = false;   // CLOCK bit, set on every read and write
+         TimerWheel::Timer timer;   // linked in the wheel while expires_ms != 0
+     };
+     struct Partition {
+         std::unordered_map<std::string, Versioned> data;
+         HybridClock clock;   // guarded by mu
+         size_t bytes = 0;    // approximate footprint of data, guarded by mu
+         size_t hand = 0;     // CLOCK hand: next bucket of data to sweep
+         std::vector<std::string> victims;
+         Mutex mu;
+         // The wheel has its own lock so the sweeper can advance it
+         // without holding mu. Lock order: mu, then wheel_mu.
+         TimerWheel wheel{HybridClock::wall_ms()};
+         Mutex wheel_mu;
+     };
+     std::vector<std::unique_ptr<Partition>> parts_;
+     size_t budget_;   // bytes per partition, 0 = unbounded
+ 
+     // Per-entry cost beyond the key and value bytes: the map node (which
+     // holds the entry's timer) plus its next and bucket pointers
+     static constexpr size_t ENTRY_OVERHEAD =
+         sizeof(std::pair<const std::string, Versioned>) + 2 * sizeof(void*);
+     // Due timers re-checked per acquisition of a partition lock
+     static constexpr size_t EXPIRE_CHUNK = 256;
+ 
+     // Outgoing key migrations, by joining node id. A transfer is kept
+     // until the joiner acknowledges it or it has been idle XFER_TTL_MS, so
+     // an interrupted joiner can resume from any offset. Each snapshot gets
+     // a new generation, and chunk/done requests must name it, so a joiner
+     // can never mix or acknowledge a snapshot it did not start.
+     struct Transfer {
+         std::string stream;
+         std::vector<std::pair<std::string, uint64_t>> keys;   // key, version sent
+         uint64_t gen;
+         uint64_t touched_ms;   // last send_keys/chunk request
+         int round = 0;         // send_keys_done rounds completed
+         std::string delta;     // reply to the last round, for a retry
+     };
+     std::unordered_map<int, Transfer> transfers_;
+     uint64_t xfer_gen_ = 0;
+     Mutex xfer_mu_;
+ 
+     // A transfer touched this recently is being fetched, and send_keys
+     // for its joiner returns it rather than starting over
+     static constexpr uint64_t XFER_ACTIVE_MS = 1000;
+     // An abandoned transfer is dropped after this long
+     static constexpr uint64_t XFER_TTL_MS = 30000;
  public:
+     explicit DataStore(size_t partitions = 1, size_t max_bytes = 0) {
+         if (partitions == 0) partitions = 1;
+         for (size_t i = 0; i < partitions; ++i) parts_.emplace_back(new Partition());
+         budget_ = max_bytes / partitions;
+         if (max_bytes != 0 && budget_ == 0) budget_ = 1;
+     }
      virtual ~DataStore() = default;
      virtual int self_id() const { return 0; }
  
-     void insert(const std::string &k, const std::string &v) {
-         LockGuard lock(mu_);
-         data_[k] = v;
+     size_t partitions() const { return parts_.size(); }
+     // Partition owning k. The low m bits of the hash pick the ring
+     // position, so the partition comes from the bits above them.
+     size_t partition_of(std::string_view k) const {
+         return (std::hash<std::string_view>{}(k) >> m) % parts_.size();
      }
-     void remove(const std::string &k) {
-         LockGuard lock(mu_);
-         data_.erase(k);
+ 
+     // Applies a batch of writes to one partition under a single lock
+     // acquisition; every key in the batch must belong to that partition
+     void apply_batch(size_t part, const std::vector<WriteOp*> &batch) {
+         Partition &p = *parts_[part];
+         LockGuard lock(p.mu);
+         for (WriteOp *w : batch) apply(p, *w);
+     }
+     // Last-writer-wins apply of a pair versioned by another node;
+     // false when the local copy is at least as new or the pair has expired
+     bool merge(const std::string &k, std::string_view v, uint64_t version, uint64_t expires_ms) {
+         if (expires_ms != 0 && expires_ms <= HybridClock::wall_ms()) return false;
+         Partition &p = *parts_[partition_of(k)];
+         LockGuard lock(p.mu);
+         p.clock.observe(version);
+         auto it = p.data.find(k);
+         if (it != p.data.end() && version <= it->second.version) return false;
+         store(p, k, v, version, expires_ms);
+         evict(p);
+         return true;
+     }
+     // Applies a tombstone from another node: drops the local copy unless
+     // it is newer than the deleted version
+     bool merge_erase(const std::string &k, uint64_t version) {
+         Partition &p = *parts_[partition_of(k)];
+         LockGuard lock(p.mu);
+         auto it = p.data.find(k);
+         if (it == p.data.end() || it->second.version > version) return false;
+         erase(p, it);
+         return true;
+     }
+     // Copies the value into the caller's buffer; false on miss
+     bool search(const std::string &k, std::string &out) {
+         return search_versioned(k, out) != 0;
+     }
+     // As search, returning the value's version; 0 on miss
+     uint64_t search_versioned(const std::string &k, std::string &out) {
+         Partition &p = *parts_[partition_of(k)];
+         LockGuard lock(p.mu);
+         auto it = p.data.find(k);
+         if (it == p.data.end()) return 0;
+         if (it->second.expires_ms != 0 && it->second.expires_ms <= HybridClock::wall_ms()) {
+             erase(p, it);
+             return 0;
+         }
+         it->second.referenced = true;
+         out.assign(it->second.value);
+         return it->second.version;
+     }
+     // Reclaims keys whose TTL has passed. The wheel is advanced under its
+     // own lock, and due timers are taken in chunks of EXPIRE_CHUNK, so the
+     // store lock is only held briefly. A due timer always belongs to a
+     // live entry: rewrites move an entry's timer and erases cancel it.
+     void expire(uint64_t now_ms) {
+         for (auto &part : parts_) {
+             Partition &p = *part;
+             {
+                 LockGuard wlock(p.wheel_mu);
+                 p.wheel.advance(now_ms);
+             }
+             bool more = true;
+             while (more) {
+                 LockGuard lock(p.mu);
+                 for (size_t n = 0; n < EXPIRE_CHUNK; ++n) {
+                     TimerWheel::Timer *tm;
+                     {
+                         LockGuard wlock(p.wheel_mu);
+                         tm = p.wheel.pop_due();
+                         // A parked out-of-range timer goes back in the wheel
+                         if (tm && tm->expires_ms > now_ms) {
+                             p.wheel.schedule(*tm, tm->expires_ms);
+                             continue;
+                         }
+                     }
+                     if (!tm) {
+                         more = false;
+                         break;
+                     }
+                     erase(p, p.data.find(*tm->key));
+                 }
+             }
+         }
+     }
+     // send_keys: snapshot the pairs whose key_id is now owned by
+     // joining_id into a KeyStream and return its length and generation.
+     // A transfer still being fetched is returned unchanged; an idle one
+     // (the joiner gave up or restarted) is replaced by a fresh snapshot.
+     size_t send_keys(int joining_id, uint64_t &gen) {
+         LockGuard xlock(xfer_mu_);
+         uint64_t now = HybridClock::wall_ms();
+         auto found = transfers_.find(joining_id);
+         if (found != transfers_.end()) {
+             if (now - found->second.touched_ms < XFER_ACTIVE_MS) {
+                 found->second.touched_ms = now;
+                 gen = found->second.gen;
+                 return found->second.stream.size();
+             }
+             transfers_.erase(found);
+         }
+ 
+         // Partitions are snapshotted one at a time, so values are copied
+         // out rather than read back from the maps after sorting
+         struct Entry { std::string key; uint64_t version, expires_ms; std::string value; };
+         std::vector<Entry> entries;
+         for (auto &part : parts_) {
+             LockGuard lock(part->mu);
+             for (auto &p : part->data) {
+                 if (p.second.expires_ms != 0 && p.second.expires_ms <= now) continue;
+                 int key_id = static_cast<int>(std::hash<std::string>{}(p.first) % RING_SIZE);
+                 int dist_to_join = (joining_id - key_id + RING_SIZE) % RING_SIZE;
+                 int dist_to_self = (self_id() - key_id + RING_SIZE) % RING_SIZE;
+                 if (dist_to_join < dist_to_self)
+                     entries.push_back(Entry{p.first, p.second.version, p.second.expires_ms, p.second.value});
+             }
+         }
+         std::sort(entries.begin(), entries.end(),
+                   [](const Entry &a, const Entry &b) { return a.key < b.key; });
+ 
+         Transfer &t = transfers_[joining_id];
+         t.gen = gen = ++xfer_gen_;
+         t.touched_ms = now;
+         KeyStream::Writer w(t.stream);
+         for (auto &e : entries) {
+             w.add(e.key, e.version, e.expires_ms, e.value);
+             t.keys.emplace_back(std::move(e.key), e.version);
+         }
+         w.finish();
+         return t.stream.size();
+     }
+     // Appends up to max bytes of a pending transfer, starting at offset
+     bool send_keys_chunk(int joining_id, uint64_t gen, size_t offset, size_t max, std::string &out) {
+         LockGuard xlock(xfer_mu_);
+         auto found = transfers_.find(joining_id);
+         if (found == transfers_.end() || found->second.gen != gen
+             || offset > found->second.stream.size()) return false;
+         found->second.touched_ms = HybridClock::wall_ms();
+         out.append(found->second.stream, offset, max);
+         return true;
+     }
+     // Round `round` of handing the migrated keys over. The joiner has
+     // applied the stream and the deltas of all earlier rounds, so every
+     // key still at the version it was last sent at is dropped here. Keys
+     // rewritten or deleted since are kept, and appended to out as a
+     // KeyStream delta (deleted ones as tombstones) to be sent again at
+     // their new versions. Rounds repeat until a delta is empty, which
+     // ends the transfer. A retried round gets the same delta back.
+     bool send_keys_done(int joining_id, uint64_t gen, int round, std::string &out) {
+         LockGuard xlock(xfer_mu_);
+         auto found = transfers_.find(joining_id);
+         if (found == transfers_.end() || found->second.gen != gen) return false;
+         Transfer &t = found->second;
+         t.touched_ms = HybridClock::wall_ms();
+         if (round == t.round - 1) {
+             out.append(t.delta);
+             return true;
+         }
+         if (round != t.round) return false;
+ 
+         std::vector<std::pair<std::string, uint64_t>> resend;
+         t.delta.clear();
+         KeyStream::Writer w(t.delta);
+         for (auto &kv : t.keys) {
+             Partition &p = *parts_[partition_of(kv.first)];
+             LockGuard lock(p.mu);
+             auto it = p.data.find(kv.first);
+             if (it != p.data.end() && it->second.expires_ms != 0 && it->second.expires_ms <= t.touched_ms) {
+                 erase(p, it);
+                 it = p.data.end();
+             }
+             if (it == p.data.end()) {
+                 w.add_tombstone(kv.first, kv.second);
+             } else if (it->second.version == kv.second) {
+                 erase(p, it);
+             } else {
+                 w.add(kv.first, it->second.version, it->second.expires_ms, it->second.value);
+                 resend.emplace_back(kv.first, it->second.version);
+             }
+         }
+         w.finish();
+         bool settled = t.delta.size() == sizeof(KeyStream::MAGIC);
+         out.append(t.delta);
+         if (settled) {
+             transfers_.erase(found);
+         } else {
+             t.keys.swap(resend);
+             ++t.round;
+         }
+         return true;
+     }
+     // Drops transfers idle for XFER_TTL_MS; their keys stay here
+     void prune_transfers(uint64_t now_ms) {
+         LockGuard xlock(xfer_mu_);
+         for (auto it = transfers_.begin(); it != transfers_.end(); ) {
+             if (now_ms - it->second.touched_ms >= XFER_TTL_MS) it = transfers_.erase(it);
+             else ++it;
+         }
+     }
+ 
+ private:
+     using Iter = std::unordered_map<std::string, Versioned>::iterator;
+ 
+     // The helpers below expect the caller to hold p.mu
+     void apply(Partition &p, WriteOp &w) {
+         switch (w.kind) {
+         case WriteOp::Put: {
+             uint64_t expires = w.ttl_ms ? HybridClock::wall_ms() + w.ttl_ms : 0;
+             w.version = p.clock.tick(self_id());
+             store(p, *w.key, w.value, w.version, expires);
+             w.ok = true;
+             break;
+         }
+         case WriteOp::Erase: {
+             auto it = p.data.find(*w.key);
+             if (it != p.data.end()) erase(p, it);
+             w.ok = true;
+             break;
+         }
+         case WriteOp::Cas: {
+             auto it = p.data.find(*w.key);
+             uint64_t cur = it == p.data.end() ? 0 : it->second.version;
+             if (cur != 0 && it->second.expires_ms != 0 && it->second.expires_ms <= HybridClock::wall_ms()) {
+                 erase(p, it);
+                 cur = 0;
+             }
+             if (cur != w.expect) {
+                 w.version = cur;
+                 w.ok = false;
+                 break;
+             }
+             // A cas replaces the value only; the key keeps its TTL
+             w.version = p.clock.tick(self_id());
+             store(p, *w.key, w.value, w.version, cur == 0 ? 0 : it->second.expires_ms);
+             w.ok = true;
+             break;
+         }
+         }
+         evict(p);
+     }
+     // Overwriting an existing key reuses its storage; only new keys allocate
+     void store(Partition &p, const std::string &k, std::string_view v,
+                uint64_t version, uint64_t expires_ms) {
+         auto res = p.data.try_emplace(k);
+         Versioned &e = res.first->second;
+         if (res.second) p.bytes += k.size() + ENTRY_OVERHEAD;
+         p.bytes = p.bytes - e.value.size() + v.size();
+         e.value.assign(v.data(), v.size());
+         e.version = version;
+         e.expires_ms = expires_ms;
+         e.referenced = true;
+         // Move the entry's one timer, or cancel it when the TTL is dropped
+         if (expires_ms != 0 || e.timer.scheduled()) {
+             LockGuard wlock(p.wheel_mu);
+             if (expires_ms != 0) {
+                 e.timer.key = &res.first->first;
+                 p.wheel.schedule(e.timer, expires_ms);
+             } else {
+                 p.wheel.cancel(e.timer);
+             }
+         }
+     }
+     void erase(Partition &p, Iter it) {
+         if (it->second.timer.scheduled()) {
+             LockGuard wlock(p.wheel_mu);
+             p.wheel.cancel(it->second.timer);
+         }
+         p.bytes -= it->first.size() + it->second.value.size() + ENTRY_OVERHEAD;
+         p.data.erase(it);
+     }
+     // CLOCK over the map's buckets: the hand clears reference bits and
+     // evicts unreferenced entries until the partition fits its budget
+     void evict(Partition &p) {
+         if (budget_ == 0) return;
+         while (p.bytes > budget_ && !p.data.empty()) {
+             size_t b = p.hand++ % p.data.bucket_count();
+             for (auto it = p.data.begin(b); it != p.data.end(b); ++it) {
+                 if (it->second.referenced) it->second.referenced = false;
+                 else p.victims.push_back(it->first);
+             }
+             for (auto &k : p.victims) erase(p, p.data.find(k));
+             p.victims.clear();
+         }
      }
-     std::string search(const std::string &k) {
+ };
+ 
+ // Logical CPUs an affinity mask can address
+ static int cpu_count() {
+     SYSTEM_INFO si;
+     GetSystemInfo(&si);
+     int ncpu = static_cast<int>(si.dwNumberOfProcessors);
+     if (ncpu > static_cast<int>(8 * sizeof(DWORD_PTR))) ncpu = 8 * sizeof(DWORD_PTR);
+     return ncpu;
+ }
+ 
+ // Pins the calling thread to one logical CPU. main() keeps --shards
+ // within cpu_count(); the wrap only guards other callers.
+ static void pin_to_core(int core) {
+     int ncpu = cpu_count();
+     if (ncpu <= 0) return;
+     SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (core % ncpu));
+ }
+ 
+ // Group-commit tuning: a batch is applied once max_batch writes are
+ // queued or the oldest queued write has waited window_ms, whichever
+ // comes first. window_ms = 0 adds no delay; writes that arrive while a
+ // batch is being applied still form the next batch.
+ struct BatchConfig {
+     size_t max_batch = 64;
+     DWORD window_ms = 0;
+ };
+ 
+ // Queues server-side writes (insert_server, insert_ttl_server,
+ // delete_server, cas_server) from connection threads and applies them to
+ // the DataStore in batches from a single committer thread
+ class WriteBatcher {
+     BatchConfig cfg_;
+     Mutex mu_;
+     CondVar queued_, applied_;
+     std::vector<WriteOp*> queue_, draining_;
+ public:
+     explicit WriteBatcher(const BatchConfig &cfg) : cfg_(cfg) {
+         if (cfg_.max_batch == 0) cfg_.max_batch = 1;
+         queue_.reserve(cfg_.max_batch);
+         draining_.reserve(cfg_.max_batch);
+     }
+ 
+     // Queues w without waiting; w must stay alive until wait(w) returns
+     void enqueue(WriteOp &w) {
          LockGuard lock(mu_);
-         auto it = data_.find(k);
-         return it != data_.end() ? it->second : std::string();
+         w.done = false;
+         if (cfg_.window_ms > 0) w.queued_ms = GetTickCount64();
+         queue_.push_back(&w);
+         if (queue_.size() == 1 || queue_.size() >= cfg_.max_batch) queued_.notify_one();
      }
-     // send_keys: send key|value pairs where key_id <= joining_id
-     std::string send_keys(int joining_id) {
+     // Blocks until a queued w has been applied
+     void wait(WriteOp &w) {
          LockGuard lock(mu_);
-         std::ostringstream oss;
-         std::vector<std::string> to_remove;
-         for (auto &p : data_) {
-             int key_id = static_cast<int>(std::hash<std::string>{}(p.first) % RING_SIZE);
-             int dist_to_join = (joining_id - key_id + RING_SIZE) % RING_SIZE;
-             int dist_to_self = (self_id() - key_id + RING_SIZE) % RING_SIZE;
-             if (dist_to_join < dist_to_self) {
-                 oss << p.first << "|" << p.second << ":";
-                 to_remove.push_back(p.first);
+         while (!w.done) applied_.wait(mu_);
+     }
+     void submit(WriteOp &w) {
+         enqueue(w);
+         wait(w);
+     }
+ 
+     // Committer loop for one DataStore partition; never returns
+     void run(DataStore &ds, size_t part) {
+         mu_.lock();
+         while (true) {
+             while (queue_.empty()) queued_.wait(mu_);
+             if (cfg_.window_ms > 0) {
+                 // The window runs from when the oldest write was queued,
+                 // not from when this thread woke up
+                 ULONGLONG deadline = queue_.front()->queued_ms + cfg_.window_ms;
+                 while (queue_.size() < cfg_.max_batch) {
+                     ULONGLONG now = GetTickCount64();
+                     if (now >= deadline) break;
+                     queued_.wait(mu_, static_cast<DWORD>(deadline - now));
+                 }
              }
+             // Take at most max_batch writes; the rest start the next batch
+             size_t n = queue_.size() < cfg_.max_batch ? queue_.size() : cfg_.max_batch;
+             draining_.assign(queue_.begin(), queue_.begin() + n);
+             queue_.erase(queue_.begin(), queue_.begin() + n);
+             mu_.unlock();
+             ds.apply_batch(part, draining_);
+             mu_.lock();
+             for (WriteOp *w : draining_) w->done = true;
+             draining_.clear();
+             applied_.notify_all();
          }
-         for (auto &k : to_remove) data_.erase(k);
-         return oss.str();
      }
  };
  
@@ -101,6 +934,12 @@
      NodeInfo() : ip(), port(0), id(-1) {}
      NodeInfo(std::string ip_, int port_, int id_) : ip(std::move(ip_)), port(port_), id(id_) {}
      std::string str() const { return ip + "|" + std::to_string(port); }
+     // Same encoding as str(), written into a reusable buffer
+     void write(std::string &out) const {
+         char num[16];
+         auto res = std::to_chars(num, num + sizeof(num), port);
+         out.append(ip).append(1, '|').append(num, res.ptr - num);
+     }
  };
  
  // Finger table entries
@@ -127,24 +966,171 @@
  class RequestHandler {
  public:
      std::string send_message(const std::string &ip, int port, const std::string &msg) {
+         std::string resp;
+         send_message(ip, port, msg + "\n", resp);
+         return resp;
+     }
+     // Sends msg verbatim (caller supplies the trailing newline) and
+     // overwrites resp with the reply; resp keeps its capacity across calls.
+     // The connection is framed, so the reply is read up to its '\n'.
+     bool send_message(const std::string &ip, int port, std::string_view msg, std::string &resp) {
+         resp.clear();
+         SOCKET sock = connect_to(ip, port);
+         if (sock == INVALID_SOCKET) return false;
+         send_request(sock, msg);
+         char buf[1024];
+         bool done = false;
+         int r;
+         while (!done && (r = recv(sock, buf, sizeof(buf), 0)) > 0) {
+             done = buf[r - 1] == '\n';
+             resp.append(buf, done ? r - 1 : r);
+         }
+         closesocket(sock);
+         return done;
+     }
+     // Like send_message, for replies framed as a u32 little-endian length
+     // followed by that many bytes; resp receives the payload only
+     bool send_framed(const std::string &ip, int port, std::string_view msg, std::string &resp) {
+         resp.clear();
+         SOCKET sock = connect_to(ip, port);
+         if (sock == INVALID_SOCKET) return false;
+         send_request(sock, msg);
+         char buf[4096];
+         size_t need = SIZE_MAX;
+         std::string in;
+         while (in.size() < need) {
+             int r = recv(sock, buf, sizeof(buf), 0);
+             if (r <= 0) break;
+             in.append(buf, r);
+             if (need == SIZE_MAX && in.size() >= 4)
+                 need = 4 + KeyStream::get_u32(reinterpret_cast<const unsigned char*>(in.data()));
+         }
+         closesocket(sock);
+         if (in.size() < need || need == SIZE_MAX) return false;
+         resp.assign(in, 4, need - 4);
+         return true;
+     }
+ private:
+     // Sends msg behind an empty line, which marks the connection as
+     // framed before the server has seen any of the request (client_thread
+     // would otherwise take a first recv without '\n' as a whole request).
+     // One send, so the marker does not go out as a segment of its own.
+     static void send_request(SOCKET sock, std::string_view msg) {
+         thread_local std::string out;
+         out.assign(1, '\n').append(msg.data(), msg.size());
+         send(sock, out.data(), static_cast<int>(out.size()), 0);
+     }
+     static SOCKET connect_to(const std::string &ip, int port) {
          SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
-         if (sock == INVALID_SOCKET) return {};
+         if (sock == INVALID_SOCKET) return sock;
          sockaddr_in srv{};
          srv.sin_family = AF_INET;
          srv.sin_addr.s_addr = inet_addr(ip.c_str());
          srv.sin_port = htons(port);
          if (::connect(sock, reinterpret_cast<sockaddr*>(&srv), sizeof(srv)) != 0) {
              closesocket(sock);
-             return {};
+             return INVALID_SOCKET;
          }
-         std::string out = msg + "\n";
-         send(sock, out.c_str(), static_cast<int>(out.size()), 0);
-         char buf[1024];
-         int r = recv(sock, buf, sizeof(buf), 0);
-         std::string resp;
-         if (r > 0) resp.assign(buf, r);
-         closesocket(sock);
-         return resp;
+         return sock;
+     }
+ };
+ 
+ // Request opcodes, decoded once from the text prefix before dispatch
+ enum class Op {
+     Unknown,
+     Insert, Delete, Search,
+     InsertServer, DeleteServer, SearchServer,
+     InsertTtl, InsertTtlServer,
+     GetVersioned, GetVersionedServer, Cas, CasServer,
+     SendKeys, SendKeysChunk, SendKeysDone,
+     JoinRequest, GetSuccessor, GetPredecessor, Notify
+ };
+ 
+ // Perfect hash over the opcode names: (length, first char) is unique for
+ // every name, so the switch picks one candidate and a single compare
+ // confirms it. A collision shows up as a duplicate case label at compile time.
+ static constexpr unsigned op_key(std::string_view s) {
+     return s.empty() ? 0u
+                      : (static_cast<unsigned>(s.size()) << 8) | static_cast<unsigned char>(s[0]);
+ }
+ 
+ static Op decode_op(std::string_view s) {
+ #define OP_CASE(name, op) case op_key(name): return s == name ? op : Op::Unknown;
+     switch (op_key(s)) {
+         OP_CASE("insert",          Op::Insert)
+         OP_CASE("delete",          Op::Delete)
+         OP_CASE("search",          Op::Search)
+         OP_CASE("insert_server",   Op::InsertServer)
+         OP_CASE("delete_server",   Op::DeleteServer)
+         OP_CASE("search_server",   Op::SearchServer)
+         OP_CASE("insert_ttl",      Op::InsertTtl)
+         OP_CASE("insert_ttl_server", Op::InsertTtlServer)
+         OP_CASE("getv",            Op::GetVersioned)
+         OP_CASE("getv_server",     Op::GetVersionedServer)
+         OP_CASE("cas",             Op::Cas)
+         OP_CASE("cas_server",      Op::CasServer)
+         OP_CASE("send_keys",       Op::SendKeys)
+         OP_CASE("send_keys_chunk", Op::SendKeysChunk)
+         OP_CASE("send_keys_done",  Op::SendKeysDone)
+         OP_CASE("join_request",    Op::JoinRequest)
+         OP_CASE("get_successor",   Op::GetSuccessor)
+         OP_CASE("get_predecessor", Op::GetPredecessor)
+         OP_CASE("notify",          Op::Notify)
+     }
+ #undef OP_CASE
+     return Op::Unknown;
+ }
+ 
+ // A server-side write parsed from the current recv: queued on its
+ // partition's batcher, not yet waited for
+ struct PendingWrite {
+     WriteOp op{WriteOp::Put, nullptr, std::string_view()};
+     std::string key;
+     WriteBatcher *batcher = nullptr;
+     Op code = Op::Unknown;
+ };
+ 
+ // Scratch space owned by one client connection and reused for every
+ // request on it, so steady-state dispatch does not touch the heap
+ struct ConnBuffers {
+     // Longest unterminated request kept across recvs before giving up
+     static constexpr size_t MAX_REQUEST = 64 * 1024;
+ 
+     std::string resp;   // response being built
+     std::string fwd;    // request forwarded to the owning node
+     std::string key;    // owning copy of the key for map lookups
+     std::string in;     // received bytes not yet dispatched
+     std::string out;    // replies to every request in one recv, sent together
+     size_t replies = 0;    // replies in out
+     bool answered = false; // some reply in out is non-empty
+     bool framed = false;   // the peer terminates requests with '\n'
+     // Writes in flight are writes[0, queued); entries are reused, and a
+     // deque keeps them in place while the batchers hold pointers
+     std::deque<PendingWrite> writes;
+     size_t queued = 0;
+ 
+     ConnBuffers() {
+         resp.reserve(1024);
+         fwd.reserve(1024);
+         key.reserve(256);
+         in.reserve(2048);
+         out.reserve(1024);
+     }
+     // A framed peer gets every reply '\n'-terminated, so it can tell
+     // pipelined replies apart however they are split across sends
+     void reply(std::string_view r) {
+         out.append(r.data(), r.size());
+         end_reply(!r.empty());
+     }
+     // Ends a reply that was appended to out directly
+     void end_reply(bool nonempty = true) {
+         if (framed) out.push_back('\n');
+         ++replies;
+         answered |= nonempty;
+     }
+     PendingWrite &next_write() {
+         if (queued == writes.size()) writes.emplace_back();
+         return writes[queued++];
      }
  };
  
@@ -156,38 +1142,92 @@
      NodeInfo self_, pred_, succ_;
      FingerTable fingers_;
      RequestHandler rpc_;
+     // One batcher per DataStore partition; a write is queued on the
+     // batcher of the partition that owns its key
+     std::vector<std::unique_ptr<WriteBatcher>> batchers_;
+     bool pinned_;   // sharded mode: pin accept loops and committers to cores
+     int first_core_ = 0;   // core of partition 0 when pinned
+     // This process's virtual nodes sorted by id, empty unless --vnodes.
+     // Set before start() and read-only afterwards.
+     std::vector<NodeInfo> vnodes_;
+ 
+     static constexpr size_t XFER_CHUNK = 64 * 1024;   // bytes per send_keys_chunk reply
+     static constexpr int XFER_RETRIES = 5;
  
  public:
-     Node(const std::string &ip, int port)
-         : self_{ip, port, hash_str(ip + "|" + std::to_string(port))}
+     Node(const std::string &ip, int port, const BatchConfig &batch = BatchConfig(),
+          size_t shards = 1, size_t max_bytes = 0)
+         : DataStore(shards, max_bytes)
+         , self_{ip, port, hash_str(ip + "|" + std::to_string(port))}
          , pred_(), succ_(self_)
          , fingers_(self_.id)
-     {}
+         , pinned_(shards > 1)
+     {
+         for (size_t i = 0; i < partitions(); ++i)
+             batchers_.emplace_back(new WriteBatcher(batch));
+     }
  
-     static int hash_str(const std::string &s) {
-         return static_cast<int>(std::hash<std::string>{}(s) % RING_SIZE);
+     // std::hash<string_view> matches std::hash<string> for equal contents
+     static int hash_str(std::string_view s) {
+         return static_cast<int>(std::hash<std::string_view>{}(s) % RING_SIZE);
      }
      int self_id() const override { return self_.id; }
  
-     std::string process_request(const std::string &msg);
+     // Handles one request. Returns true with the reply in cb.resp, or
+     // false when a server-side write was queued and its reply deferred to
+     // flush_writes(). Any other request flushes queued writes first, so it
+     // sees them and the replies stay in request order.
+     bool process_request(std::string_view msg, ConnBuffers &cb);
+     // Waits for the connection's queued writes and appends their replies
+     void flush_writes(ConnBuffers &cb);
+     void run_batcher(int shard) {
+         if (pinned_) pin_to_core(first_core_ + shard);
+         batchers_[shard]->run(*this, shard);
+     }
+     // Makes this node one of the process's virtual nodes: its threads run
+     // on cores from first_core, and keys are routed among ring, which
+     // lists every virtual node in the process
+     void run_as_vnode(int first_core, std::vector<NodeInfo> ring) {
+         pinned_ = true;
+         first_core_ = first_core;
+         std::sort(ring.begin(), ring.end(),
+                   [](const NodeInfo &a, const NodeInfo &b) { return a.id < b.id; });
+         vnodes_ = std::move(ring);
+     }
      void start();
+     void accept_loop(SOCKET listener, int core);
      // In the public section of class Node
     void bootstrap(const std::string &contact_ip, int contact_port);
 
  private:
-     static std::vector<std::string> split(const std::string &s, char d) {
-         std::vector<std::string> v;
-         std::istringstream iss(s);
-         std::string t;
-         while (std::getline(iss, t, d)) v.push_back(t);
-         return v;
+     // Parses a decimal int; -1 when s is not a number
+     static int parse_int(std::string_view s) {
+         int v = 0;
+         auto res = std::from_chars(s.data(), s.data() + s.size(), v);
+         return res.ec == std::errc() ? v : -1;
+     }
+     static bool parse_u64(std::string_view s, uint64_t &v) {
+         auto res = std::from_chars(s.data(), s.data() + s.size(), v);
+         return res.ec == std::errc() && res.ptr == s.data() + s.size();
      }
-     static NodeInfo decode(const std::string &s) {
-         auto parts = split(s, '|');
-         return NodeInfo(parts[0], std::stoi(parts[1]), hash_str(s));
+     static void append_u64(std::string &out, uint64_t v) {
+         char num[24];
+         auto res = std::to_chars(num, num + sizeof(num), v);
+         out.append(num, res.ptr - num);
      }
-     NodeInfo find_successor(int nid) {
-         return (succ_.str() == self_.str() ? self_ : succ_);
+     static NodeInfo decode(std::string_view s) {
+         auto bar = s.find('|');
+         if (bar == std::string_view::npos) return NodeInfo();
+         return NodeInfo(std::string(s.substr(0, bar)), parse_int(s.substr(bar + 1)), hash_str(s));
+     }
+     const NodeInfo &find_successor(int nid) const {
+         // Virtual nodes: the first one at or after nid on the ring owns it
+         if (!vnodes_.empty()) {
+             auto it = std::lower_bound(vnodes_.begin(), vnodes_.end(), nid,
+                                        [](const NodeInfo &a, int id) { return a.id < id; });
+             return it == vnodes_.end() ? vnodes_.front() : *it;
+         }
+         return (succ_.port == self_.port && succ_.ip == self_.ip) ? self_ : succ_;
      }
      void notify(int nid, const NodeInfo &ni) {
          pred_ = ni;
@@ -202,15 +1242,94 @@
     );
     succ_ = decode(reply);
 
-    // 2) Grab any keys you should now own
-    std::string kvpairs = rpc_.send_message(
-        succ_.ip, succ_.port,
-        "send_keys|" + std::to_string(self_id())
-    );
-    for (auto &entry : split(kvpairs, ':')) {
-        if (entry.empty()) continue;
-        auto sep = entry.find('|');
-        insert(entry.substr(0,sep), entry.substr(sep+1));
+    // 2) Pull the keys we now own as a KeyStream. Only verified blocks
+    //    are applied; after a failed fetch or a corrupt block we resume
+    //    from the offset of the first block not yet applied.
+    //    Every request names the snapshot's generation, so if the old
+    //    owner replaces it (we stalled past its lifetime) the fetch fails
+    //    instead of splicing two snapshots.
+    std::string id = std::to_string(self_id());
+    if (!rpc_.send_message(succ_.ip, succ_.port, "send_keys|" + id + "\n", reply)) return;
+    auto sep = reply.find('|');
+    if (sep == std::string::npos) return;
+    id.append(1, '|').append(reply, 0, sep);   // "<id>|<gen>"
+    int total = parse_int(std::string_view(reply).substr(sep + 1));
+    if (total <= 0) return;
+
+    std::string pending, chunk, raw, key;
+    size_t applied = 0;         // stream offset of pending.front()
+    int failures = 0;
+    bool header = false;
+    while (applied + pending.size() < static_cast<size_t>(total) || !pending.empty()) {
+        if (applied + pending.size() < static_cast<size_t>(total)) {
+            std::string req = "send_keys_chunk|" + id + "|"
+                            + std::to_string(applied + pending.size()) + "\n";
+            if (!rpc_.send_framed(succ_.ip, succ_.port, req, chunk) || chunk.empty()) {
+                if (++failures > XFER_RETRIES) return;
+                Sleep(100 * failures);
+                continue;
+            }
+            pending.append(chunk);
+        }
+        size_t pos = 0;
+        if (!header) {
+            if (pending.size() < sizeof(KeyStream::MAGIC)) continue;
+            if (!KeyStream::read_magic(pending)) return;
+            pos = sizeof(KeyStream::MAGIC);
+            header = true;
+        }
+        KeyStream::Status st = KeyStream::Status::Ok;
+        while (pos < pending.size()) {
+            size_t used = 0;
+            st = KeyStream::read_block(std::string_view(pending).substr(pos), used, raw, key,
+                [this](std::string_view k, uint64_t version, uint64_t expires_ms, std::string_view v, bool) {
+                    merge(std::string(k), v, version, expires_ms);
+                });
+            if (st != KeyStream::Status::Ok) break;
+            pos += used;
+        }
+        applied += pos;
+        pending.erase(0, pos);
+        if (st == KeyStream::Status::Corrupt) {
+            if (++failures > XFER_RETRIES) return;
+            pending.clear();
+        } else if (st == KeyStream::Status::Incomplete && applied + pending.size() >= static_cast<size_t>(total)) {
+            return;   // truncated stream
+        }
+    }
+
+    // 3) Hand-over rounds: the old owner drops the keys we now hold and
+    //    replies with the ones rewritten or deleted there meanwhile, which
+    //    we merge before the next round lets it drop those too
+    int round = 0;
+    failures = 0;
+    while (true) {
+        std::string req = "send_keys_done|" + id + "|" + std::to_string(round) + "\n";
+        if (!rpc_.send_framed(succ_.ip, succ_.port, req, chunk) || !KeyStream::read_magic(chunk)) {
+            if (++failures > XFER_RETRIES) return;
+            Sleep(100 * failures);
+            continue;
+        }
+        size_t pos = sizeof(KeyStream::MAGIC), entries = 0;
+        while (pos < chunk.size()) {
+            size_t used = 0;
+            KeyStream::Status st = KeyStream::read_block(std::string_view(chunk).substr(pos), used, raw, key,
+                [this, &entries](std::string_view k, uint64_t version, uint64_t expires_ms,
+                                 std::string_view v, bool tombstone) {
+                    ++entries;
+                    if (tombstone) merge_erase(std::string(k), version);
+                    else merge(std::string(k), v, version, expires_ms);
+                });
+            if (st != KeyStream::Status::Ok) break;
+            pos += used;
+        }
+        if (pos != chunk.size()) {
+            // Corrupt delta: entries applied so far are idempotent, retry
+            if (++failures > XFER_RETRIES) return;
+            continue;
+        }
+        if (entries == 0) break;
+        ++round;
     }
 }
 
@@ -235,78 +1354,327 @@ DWORD WINAPI fix_fingers_thread(LPVOID param) {
     return 0;
 }
 
-DWORD WINAPI client_thread(LPVOID param) {
-    auto args = static_cast<std::pair<Node*, SOCKET>*>(param);
+DWORD WINAPI expiry_thread(LPVOID param) {
+    Node *n = static_cast<Node*>(param);
+    while (true) {
+        Sleep(static_cast<DWORD>(TimerWheel::TICK_MS));
+        uint64_t now = HybridClock::wall_ms();
+        n->expire(now);
+        n->prune_transfers(now);
+    }
+    return 0;
+}
+
+DWORD WINAPI batch_thread(LPVOID param) {
+    auto args = static_cast<std::pair<Node*, int>*>(param);
     Node *n = args->first;
-    SOCKET client = args->second;
+    int shard = args->second;
+    delete args;
+    n->run_batcher(shard);
+    return 0;
+}
+
+// Arguments for an accept loop or a connection thread; core < 0 = unpinned
+struct ClientArgs {
+    Node *self;
+    SOCKET sock;
+    int core;
+};
+
+// Runs a virtual node other than the first, which main() runs itself
+DWORD WINAPI node_thread(LPVOID param) {
+    static_cast<Node*>(param)->start();
+    return 0;
+}
+
+DWORD WINAPI accept_thread(LPVOID param) {
+    ClientArgs *args = static_cast<ClientArgs*>(param);
+    args->self->accept_loop(args->sock, args->core);
+    delete args;
+    return 0;
+}
+
+DWORD WINAPI client_thread(LPVOID param) {
+    ClientArgs *args = static_cast<ClientArgs*>(param);
+    Node *n = args->self;
+    SOCKET client = args->sock;
+    if (args->core >= 0) pin_to_core(args->core);
     delete args;
     char buf[1024];
-    int r = recv(client, buf, sizeof(buf), 0);
-    if (r > 0) {
-        std::string msg(buf, r);
-        if (!msg.empty() && msg.back()=='\n') msg.pop_back();
-        std::string resp = n->process_request(msg);
-        send(client, resp.c_str(), static_cast<int>(resp.size()), 0);
+    ConnBuffers cb;
+    // Serve requests until the peer closes. A peer that ends requests with
+    // '\n' may pipeline them: a request cut off by the end of a recv waits
+    // in cb.in for the rest, writes are queued together and waited for as
+    // a group, and the replies, each ending in '\n', go out in a single
+    // send. Empty lines are skipped; RequestHandler opens with one so its
+    // connections are framed from the first byte. A peer that has sent no
+    // '\n' yet (e.g. Client.cpp) gets one request per recv and an
+    // unterminated reply, as before, except that a recv which fills buf
+    // is taken as part of a longer request and read on.
+    int r;
+    while ((r = recv(client, buf, sizeof(buf), 0)) > 0) {
+        cb.in.append(buf, r);
+        cb.out.clear();
+        cb.replies = 0;
+        cb.answered = false;
+        std::string_view in(cb.in);
+        size_t pos = 0;
+        if (!cb.framed && in.find('\n') == std::string_view::npos) {
+            if (r == static_cast<int>(sizeof(buf))) {
+                if (cb.in.size() > ConnBuffers::MAX_REQUEST) break;
+                continue;
+            }
+            if (n->process_request(in, cb)) cb.reply(cb.resp);
+            pos = in.size();
+        } else {
+            cb.framed = true;
+            size_t nl;
+            while ((nl = in.find('\n', pos)) != std::string_view::npos) {
+                if (nl > pos && n->process_request(in.substr(pos, nl - pos), cb)) cb.reply(cb.resp);
+                pos = nl + 1;
+            }
+        }
+        // Queued writes point into cb.in, so wait for them before trimming it
+        n->flush_writes(cb);
+        cb.in.erase(0, pos);
+        if (cb.in.size() > ConnBuffers::MAX_REQUEST) break;
+        if (cb.replies == 0) continue;
+        // An empty reply is signalled by closing, as before
+        if (!cb.answered) break;
+        send(client, cb.out.data(), static_cast<int>(cb.out.size()), 0);
     }
     closesocket(client);
     return 0;
 }
  
- std::string Node::process_request(const std::string &msg) {
+ void Node::flush_writes(ConnBuffers &cb) {
+     for (size_t i = 0; i < cb.queued; ++i) {
+         PendingWrite &pw = cb.writes[i];
+         pw.batcher->wait(pw.op);
+         switch (pw.code) {
+         case Op::CasServer:
+             cb.out.append(pw.op.ok ? "OK|" : "CONFLICT|");
+             append_u64(cb.out, pw.op.version);
+             cb.end_reply();
+             break;
+         case Op::DeleteServer:
+             cb.reply("Deleted");
+             break;
+         default:
+             cb.out.append("OK|");
+             append_u64(cb.out, pw.op.version);
+             cb.end_reply();
+             break;
+         }
+     }
+     cb.queued = 0;
+ }
+ 
+ bool Node::process_request(std::string_view msg, ConnBuffers &cb) {
      auto bar = msg.find('|');
-     std::string op = msg.substr(0, bar);
-     std::string body = (bar == std::string::npos) ? std::string() : msg.substr(bar + 1);
-     
-     if (op == "insert_server") {
-         auto colon = body.find(':');
-         insert(body.substr(0, colon), body.substr(colon+1));
-         return "Inserted";
-     } else if (op == "delete_server") {
-         remove(body);
-         return "Deleted";
-     } else if (op == "search_server") {
-         auto v = search(body);
-         return v.empty()? "NOT FOUND": v;
-     } else if (op == "send_keys") {
-         int nid = std::stoi(body);
-         return DataStore::send_keys(nid);
-     } else if (op == "insert") {
+     std::string_view op = msg.substr(0, bar);
+     std::string_view body = (bar == std::string_view::npos) ? std::string_view() : msg.substr(bar + 1);
+     std::string &resp = cb.resp;
+     resp.clear();
+ 
+     Op code = decode_op(op);
+     bool batched = code == Op::InsertServer || code == Op::InsertTtlServer
+                 || code == Op::DeleteServer || code == Op::CasServer;
+     if (!batched) flush_writes(cb);
+ 
+     // Parses a batched write into the next pending slot and picks the
+     // batcher of the partition that owns the key; an erase body is the key
+     auto queue_write = [&](WriteOp::Kind kind, std::string_view kv) -> PendingWrite & {
+         auto colon = kind == WriteOp::Erase ? std::string_view::npos : kv.find(':');
+         PendingWrite &pw = cb.next_write();
+         pw.key.assign(kv.substr(0, colon));
+         pw.op = WriteOp{kind, &pw.key, colon == std::string_view::npos ? std::string_view() : kv.substr(colon+1)};
+         pw.code = code;
+         pw.batcher = batchers_[partition_of(pw.key)].get();
+         return pw;
+     };
+ 
+     switch (code) {
+     case Op::InsertServer: {
+         // reply is "OK|<new version>", as for cas
+         PendingWrite &pw = queue_write(WriteOp::Put, body);
+         pw.batcher->enqueue(pw.op);
+         return false;
+     }
+     case Op::InsertTtlServer: {
+         // body is "<ttl ms>|<key>:<value>"
+         auto sep = body.find('|');
+         uint64_t ttl;
+         if (sep == std::string_view::npos || !parse_u64(body.substr(0, sep), ttl)) {
+             flush_writes(cb);
+             resp = "ERROR";
+             break;
+         }
+         PendingWrite &pw = queue_write(WriteOp::Put, body.substr(sep + 1));
+         pw.op.ttl_ms = ttl;
+         pw.batcher->enqueue(pw.op);
+         return false;
+     }
+     case Op::DeleteServer: {
+         PendingWrite &pw = queue_write(WriteOp::Erase, body);
+         pw.batcher->enqueue(pw.op);
+         return false;
+     }
+     case Op::SearchServer:
+         cb.key.assign(body);
+         if (!search(cb.key, resp)) resp = "NOT FOUND";
+         break;
+     case Op::GetVersionedServer: {
+         // reply is "<version>|<value>"
+         cb.key.assign(body);
+         uint64_t version = search_versioned(cb.key, cb.fwd);
+         if (version == 0) {
+             resp = "NOT FOUND";
+             break;
+         }
+         append_u64(resp, version);
+         resp.append(1, '|').append(cb.fwd);
+         break;
+     }
+     case Op::CasServer: {
+         // body is "<expected version>|<key>:<value>", expected 0 = absent;
+         // reply is "OK|<new version>" or "CONFLICT|<current version>"
+         auto sep = body.find('|');
+         uint64_t expect;
+         if (sep == std::string_view::npos || !parse_u64(body.substr(0, sep), expect)) {
+             flush_writes(cb);
+             resp = "ERROR";
+             break;
+         }
+         PendingWrite &pw = queue_write(WriteOp::Cas, body.substr(sep + 1));
+         pw.op.expect = expect;
+         pw.batcher->enqueue(pw.op);
+         return false;
+     }
+     case Op::SendKeys: {
+         // reply is "<gen>|<stream length>"
+         int nid = parse_int(body);
+         if (nid < 0) break;
+         uint64_t gen;
+         size_t len = DataStore::send_keys(nid, gen);
+         append_u64(resp, gen);
+         resp.append(1, '|');
+         append_u64(resp, len);
+         break;
+     }
+     case Op::SendKeysChunk: {
+         // body is "<id>|<gen>|<offset>"; reply is framed binary
+         auto sep = body.find('|');
+         auto sep2 = sep == std::string_view::npos ? sep : body.find('|', sep + 1);
+         if (sep2 == std::string_view::npos) break;
+         int nid = parse_int(body.substr(0, sep));
+         uint64_t gen;
+         int offset = parse_int(body.substr(sep2 + 1));
+         if (nid < 0 || offset < 0 || !parse_u64(body.substr(sep + 1, sep2 - sep - 1), gen)) break;
+         resp.assign(4, '\0');
+         if (!DataStore::send_keys_chunk(nid, gen, offset, XFER_CHUNK, resp)) {
+             resp.clear();
+             break;
+         }
+         uint32_t len = static_cast<uint32_t>(resp.size() - 4);
+         for (int k = 0; k < 4; ++k) resp[k] = static_cast<char>((len >> (8 * k)) & 0xFF);
+         break;
+     }
+     case Op::SendKeysDone: {
+         // body is "<id>|<gen>|<round>"; reply is the framed delta
+         auto sep = body.find('|');
+         auto sep2 = sep == std::string_view::npos ? sep : body.find('|', sep + 1);
+         if (sep2 == std::string_view::npos) break;
+         int nid = parse_int(body.substr(0, sep));
+         int round = parse_int(body.substr(sep2 + 1));
+         uint64_t gen;
+         if (nid < 0 || round < 0 || !parse_u64(body.substr(sep + 1, sep2 - sep - 1), gen)) break;
+         resp.assign(4, '\0');
+         if (!DataStore::send_keys_done(nid, gen, round, resp)) {
+             resp.clear();
+             break;
+         }
+         uint32_t len = static_cast<uint32_t>(resp.size() - 4);
+         for (int k = 0; k < 4; ++k) resp[k] = static_cast<char>((len >> (8 * k)) & 0xFF);
+         break;
+     }
+     case Op::Insert: {
          auto colon = body.find(':');
          int key_id = hash_str(body.substr(0,colon));
-         NodeInfo node = find_successor(key_id);
-         rpc_.send_message(node.ip, node.port, "insert_server|"+body);
-         return "Done";
-     } else if (op == "delete") {
+         const NodeInfo &node = find_successor(key_id);
+         cb.fwd.assign("insert_server|").append(body).append(1, '\n');
+         rpc_.send_message(node.ip, node.port, cb.fwd, resp);
+         break;
+     }
+     case Op::Delete: {
          int key_id = hash_str(body);
-         NodeInfo node = find_successor(key_id);
-         rpc_.send_message(node.ip, node.port, "delete_server|"+body);
-         return "Done";
-     } else if (op == "search") {
+         const NodeInfo &node = find_successor(key_id);
+         cb.fwd.assign("delete_server|").append(body).append(1, '\n');
+         rpc_.send_message(node.ip, node.port, cb.fwd, resp);
+         resp = "Done";
+         break;
+     }
+     case Op::Search: {
+         int key_id = hash_str(body);
+         const NodeInfo &node = find_successor(key_id);
+         cb.fwd.assign("search_server|").append(body).append(1, '\n');
+         rpc_.send_message(node.ip, node.port, cb.fwd, resp);
+         break;
+     }
+     case Op::InsertTtl: {
+         std::string_view kv = body.substr(body.find('|') + 1);
+         int key_id = hash_str(kv.substr(0, kv.find(':')));
+         const NodeInfo &node = find_successor(key_id);
+         cb.fwd.assign("insert_ttl_server|").append(body).append(1, '\n');
+         rpc_.send_message(node.ip, node.port, cb.fwd, resp);
+         break;
+     }
+     case Op::GetVersioned: {
          int key_id = hash_str(body);
-         NodeInfo node = find_successor(key_id);
-         return rpc_.send_message(node.ip, node.port, "search_server|"+body);
-     } else if (op == "join_request") {
-         int nid = std::stoi(body);
-         NodeInfo node = find_successor(nid);
-         return node.str();
-     } else if (op == "get_successor") {
-         return succ_.str();
-     } else if (op == "get_predecessor") {
-         return pred_.str();
-     } else if (op == "notify") {
-         auto parts = split(body, '|');
-         int nid = std::stoi(parts[0]);
-         NodeInfo ni = decode(parts[1]);
-         notify(nid, ni);
-         return {};
-     }
-     return {};
+         const NodeInfo &node = find_successor(key_id);
+         cb.fwd.assign("getv_server|").append(body).append(1, '\n');
+         rpc_.send_message(node.ip, node.port, cb.fwd, resp);
+         break;
+     }
+     case Op::Cas: {
+         std::string_view kv = body.substr(body.find('|') + 1);
+         int key_id = hash_str(kv.substr(0, kv.find(':')));
+         const NodeInfo &node = find_successor(key_id);
+         cb.fwd.assign("cas_server|").append(body).append(1, '\n');
+         rpc_.send_message(node.ip, node.port, cb.fwd, resp);
+         break;
+     }
+     case Op::JoinRequest: {
+         int nid = parse_int(body);
+         if (nid >= 0) find_successor(nid).write(resp);
+         break;
+     }
+     case Op::GetSuccessor:
+         succ_.write(resp);
+         break;
+     case Op::GetPredecessor:
+         pred_.write(resp);
+         break;
+     case Op::Notify: {
+         // body is "<id>|<ip>|<port>"
+         auto sep = body.find('|');
+         if (sep == std::string_view::npos) break;
+         notify(parse_int(body.substr(0, sep)), decode(body.substr(sep + 1)));
+         break;
+     }
+     case Op::Unknown:
+         break;
+     }
+     return true;
  }
  
  void Node::start() {
      // Start maintenance threads via CreateThread
      CreateThread(nullptr, 0, stabilize_thread, this, 0, nullptr);
      CreateThread(nullptr, 0, fix_fingers_thread, this, 0, nullptr);
+     CreateThread(nullptr, 0, expiry_thread, this, 0, nullptr);
+     for (size_t i = 0; i < partitions(); ++i)
+         CreateThread(nullptr, 0, batch_thread, new std::pair<Node*, int>(this, static_cast<int>(i)), 0, nullptr);
  
      SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
      sockaddr_in addr{};
@@ -316,20 +1684,87 @@ DWORD WINAPI client_thread(LPVOID param) {
      bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
      listen(listener, SOMAXCONN);
      std::cout << "Node on "<< self_.ip<<":"<< self_.port
-               <<" id="<< self_.id <<"\n";
+               <<" id="<< self_.id <<" shards="<< partitions() <<"\n";
+ 
+     // In sharded mode every core runs its own accept loop on the shared
+     // listener; connections it accepts are served on that core
+     int cores = pinned_ ? static_cast<int>(partitions()) : 1;
+     for (int core = 1; core < cores; ++core)
+         CreateThread(nullptr, 0, accept_thread, new ClientArgs{this, listener, core}, 0, nullptr);
+     accept_loop(listener, 0);
+     WSACleanup();
+ }
  
-     // Accept loop
+ void Node::accept_loop(SOCKET listener, int core) {
+     int cpu = pinned_ ? first_core_ + core : -1;
+     if (cpu >= 0) pin_to_core(cpu);
      while (true) {
          SOCKET client = accept(listener, nullptr, nullptr);
-         auto args = new std::pair<Node*, SOCKET>(this, client);
+         if (client == INVALID_SOCKET) continue;
+         auto args = new ClientArgs{this, client, cpu};
          CreateThread(nullptr, 0, client_thread, args, 0, nullptr);
      }
-     WSACleanup();
  }
+ // Benchmark drivers include this file with CHORD_NO_MAIN defined
+ #ifndef CHORD_NO_MAIN
  int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    // Pull out --batch-max=N / --batch-window-ms=N / --shards=N /
+    // --vnodes=N / --max-bytes=N; the rest are positional
+    BatchConfig batch;
+    size_t shards = 1;
+    size_t vnodes = 1;
+    size_t max_bytes = 0;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--batch-max=", 0) == 0)
+            batch.max_batch = std::stoul(a.substr(12));
+        else if (a.rfind("--batch-window-ms=", 0) == 0)
+            batch.window_ms = std::stoul(a.substr(18));
+        else if (a.rfind("--shards=", 0) == 0) {
+            // Anything but a plain number is rejected below as 0
+            const char *first = a.data() + 9, *last = a.data() + a.size();
+            auto res = std::from_chars(first, last, shards);
+            if (res.ec != std::errc() || res.ptr != last) shards = 0;
+        }
+        else if (a.rfind("--vnodes=", 0) == 0) {
+            const char *first = a.data() + 9, *last = a.data() + a.size();
+            auto res = std::from_chars(first, last, vnodes);
+            if (res.ec != std::errc() || res.ptr != last) vnodes = 0;
+        }
+        else if (a.rfind("--max-bytes=", 0) == 0)
+            max_bytes = std::stoull(a.substr(12));
+        else
+            args.push_back(a);
+    }
+    // One pinned committer per shard: more shards than cores would stack
+    // committers on a core
+    int max_shards = std::max(1, cpu_count());
+    if (shards < 1 || shards > static_cast<size_t>(max_shards)) {
+        std::cerr << "--shards must be between 1 and " << max_shards
+                  << " (the number of CPUs)\n";
+        args.clear();
+    }
+    // One core per virtual node, for the same reason
+    if (vnodes < 1 || vnodes > static_cast<size_t>(max_shards)) {
+        std::cerr << "--vnodes must be between 1 and " << max_shards
+                  << " (the number of CPUs)\n";
+        args.clear();
+    }
+    if (vnodes > 1 && shards > 1) {
+        std::cerr << "--vnodes and --shards cannot be combined\n";
+        args.clear();
+    }
+    // Virtual nodes route among themselves only; there is no ring
+    // maintenance yet to splice them into another node's ring
+    if (vnodes > 1 && args.size() == 3) {
+        std::cerr << "--vnodes cannot join a ring\n";
+        args.clear();
+    }
+    if (args.size() != 1 && args.size() != 3) {
         std::cerr << "Usage: " << argv[0]
-                  << " <port> [<contact_ip> <contact_port>]\n";
+                  << " <port> [<contact_ip> <contact_port>]"
+                  << " [--batch-max=N] [--batch-window-ms=N] [--shards=N | --vnodes=N] [--max-bytes=N]\n";
         return 1;
     }
 
@@ -340,12 +1775,34 @@ DWORD WINAPI client_thread(LPVOID param) {
         return 1;
     }
 
-    int port = std::stoi(argv[1]);
-    Node node("127.0.0.1", port);
+    int port = std::stoi(args[0]);
+    if (vnodes > 1) {
+        // Each virtual node is a whole Node on its own port and core: its
+        // own listener, store, committer and connection threads. Ports run
+        // up from <port>, skipping any whose ring id is already taken.
+        std::vector<NodeInfo> ring;
+        for (int p = port; ring.size() < vnodes; ++p) {
+            int id = Node::hash_str("127.0.0.1|" + std::to_string(p));
+            if (std::none_of(ring.begin(), ring.end(), [id](const NodeInfo &n) { return n.id == id; }))
+                ring.emplace_back("127.0.0.1", p, id);
+        }
+        size_t vnode_bytes = max_bytes == 0 ? 0 : std::max<size_t>(1, max_bytes / vnodes);
+        std::vector<std::unique_ptr<Node>> nodes;
+        for (size_t i = 0; i < vnodes; ++i) {
+            nodes.emplace_back(new Node("127.0.0.1", ring[i].port, batch, 1, vnode_bytes));
+            nodes.back()->run_as_vnode(static_cast<int>(i), ring);
+        }
+        for (size_t i = 1; i < vnodes; ++i)
+            CreateThread(nullptr, 0, node_thread, nodes[i].get(), 0, nullptr);
+        nodes[0]->start();
+        WSACleanup();
+        return 0;
+    }
+    Node node("127.0.0.1", port, batch, shards, max_bytes);
 
     // 2) Now it’s safe to bootstrap/join (uses rpc_ under the hood)
-    if (argc == 4) {
-        node.bootstrap(argv[2], std::stoi(argv[3]));
+    if (args.size() == 3) {
+        node.bootstrap(args[1], std::stoi(args[2]));
     }
 
     // 3) Finally start your server threads + accept loop
@@ -355,3 +1812,4 @@ DWORD WINAPI client_thread(LPVOID param) {
     WSACleanup();
     return 0;
 }
+ #endif